@@ -29,6 +29,30 @@
     #define QLL_Q3_ARRAY_ACCESS(ARRAY, INDEX) ARRAY[INDEX]
 #endif
 
+#ifndef QLL_Q3_ARRAY_SIZE
+    #define QLL_Q3_ARRAY_SIZE(ARRAY) ARRAY.size()
+#endif
+
+// Custom file macros: FSEEK returns 0 on success, FREAD the number of items read, FSIZE the file size or -1
+#ifndef QLL_Q3_FILE_TYPE
+    #include <cstdio>
+    #include <string>
+    #define QLL_Q3_FILE_TYPE FILE*
+
+    #define QLL_Q3_FILE_FOPEN(STR) fopen(STR.c_str(), "r+b")
+    #define QLL_Q3_FILE_FCLOSE(HANDLE) fclose(HANDLE)
+
+    #define QLL_Q3_FILE_FREAD(TARGET, COUNT, SIZE, HANDLE) fread(TARGET, SIZE, COUNT, HANDLE)
+
+    #define QLL_Q3_FILE_FSEEK(HANDLE, OFFSET) fseek(HANDLE, OFFSET, SEEK_SET)
+    #define QLL_Q3_FILE_FSIZE(HANDLE) (fseek(HANDLE, 0, SEEK_END) == 0 ? ftell(HANDLE) : -1)
+#endif
+
+// Size of the FileReader read-ahead window, in bytes
+#ifndef QLL_Q3_READ_AHEAD_SIZE
+    #define QLL_Q3_READ_AHEAD_SIZE 65536
+#endif
+
 #ifndef QLL_Q3_PREVENT_ENTITY_PARSER
     #define QLL_Q3_USE_ENTITY_PARSER
 #endif
@@ -42,6 +66,7 @@
     #endif
 
     #ifndef QLL_Q3_LOG_ERROR
+        #include <stdexcept>
         #define QLL_Q3_LOG_ERROR(ERROR) throw std::runtime_error(ERROR)
     #endif
 #endif
@@ -237,10 +262,117 @@ namespace qll { namespace q3 {
     QLL_Q3_ARRAY(QLL_Q3_ASSOCIATIVE_ARRAY(QLL_Q3_STRING, QLL_Q3_STRING)) parse_entities(const QLL_Q3_STRING& lump_data);
     #endif
 
+    /**
+     * A single positional read, used to fetch several lumps with one reader call.
+     */
+    struct ReadRequest
+    {
+        q3_int offset;             // Offset of the first byte in the file
+        q3_int length;             // Number of bytes to read
+        void* target;              // Buffer receiving the bytes
+    };
+
+    /**
+     * Byte source used by Q3Level. Implement it to load levels from archives, memory or network streams.
+     */
+    class Reader
+    {
+        public:
+            virtual ~Reader() {}
+
+            /**
+             * Total size of the file in bytes, or -1 if unknown
+             */
+            virtual q3_int size() = 0;
+
+            /**
+             * Read length bytes starting at offset, return false on short read
+             */
+            virtual bool read(q3_int offset, q3_int length, void* target) = 0;
+
+            /**
+             * Read several ranges in one call. Q3Level always passes requests sorted by offset,
+             * so the default implementation only ever moves forward in the file
+             */
+            virtual bool readMany(const ReadRequest* requests, q3_int count);
+    };
+
+    /**
+     * Default reader, built on the QLL_Q3_FILE_* macros with a read-ahead window.
+     * Seeks are skipped when reads are already contiguous.
+     */
+    class FileReader : public Reader
+    {
+        public:
+            FileReader(const QLL_Q3_STRING& filename);
+            ~FileReader();
+
+            bool isOpen() const { return _handle != 0; }
+
+            q3_int size() { return _size; }
+            bool read(q3_int offset, q3_int length, void* target);
+        protected:
+            q3_int _readDirect(q3_int offset, q3_int length, void* target);
+
+            QLL_Q3_FILE_TYPE _handle;
+            q3_int _size;
+            q3_int _position;          // Current position of the file handle, -1 if unknown
+            q3_ubyte* _buffer;         // Read-ahead window
+            q3_int _buffer_offset;
+            q3_int _buffer_length;
+    };
+
+    #ifdef QLL_Q3_USE_PREADV
+    /**
+     * POSIX reader, lumps that are adjacent in the file are fetched with a single preadv call.
+     */
+    class PosixReader : public Reader
+    {
+        public:
+            PosixReader(const QLL_Q3_STRING& filename);
+            ~PosixReader();
+
+            bool isOpen() const { return _fd >= 0; }
+
+            q3_int size() { return _size; }
+            bool read(q3_int offset, q3_int length, void* target);
+            bool readMany(const ReadRequest* requests, q3_int count);
+        protected:
+            int _fd;
+            q3_int _size;
+    };
+    #endif
+
+    /**
+     * Lumps are loaded by stage, so gameplay code can start before the heavy data is decoded.
+     */
+    enum LoadStage
+    {
+        LOAD_STAGE_GAMEPLAY = 0,   // Entities, textures, planes, nodes, leaves, models, brushes
+        LOAD_STAGE_GEOMETRY,       // Vertices, meshverts, effects, faces, visdata
+        LOAD_STAGE_LIGHTING,       // Lightmaps, lightvols
+        LOAD_STAGE_COUNT
+    };
+
+    struct __lump_header
+    {
+        q3_int offset;
+        q3_int length;
+    };
+
+    static const q3_int __quake3_bsp_lumps_count = 17;
+
     class Q3Level
     {
         public:
             Q3Level(const QLL_Q3_STRING& filename);
+
+            /**
+             * Load a level through a custom reader.
+             * In progressive mode only the gameplay stage is loaded here, the other ones are streamed
+             * by calling loadNextStage(). The reader must then outlive those calls.
+             */
+            Q3Level(Reader& reader, bool progressive = false);
             ~Q3Level();
 
             /**
@@ -248,12 +380,79 @@ namespace qll { namespace q3 {
              */
             const LevelData& getData() const { return _data; }
 
+            /**
+             * Load the next pending stage, return true while there are stages left to load
+             */
+            bool loadNextStage();
+
+            /**
+             * Number of stages loaded so far (LOAD_STAGE_COUNT once the whole level is available, 0 if the file could not be opened)
+             */
+            q3_int getLoadedStages() const { return _next_stage; }
+
+            /**
+             * True while some stages are still waiting for loadNextStage()
+             */
+            bool isLoading() const { return _reader != 0; }
+
+            /**
+             * True when the lumps of every stage up to the given one are inside the file, and every index
+             * between them is in range. Without argument, the whole level must be loaded and valid
+             */
+            bool isValidated(q3_int stage = LOAD_STAGE_COUNT - 1) const;
+
+            /**
+             * Unchecked accessors, only safe once isValidated() returned true.
+             * isValidated(LOAD_STAGE_GAMEPLAY) is enough for nodes, leaves, leaf brushes, model brushes and brush sides,
+             * accessors reaching faces or vertices need isValidated(LOAD_STAGE_GEOMETRY)
+             */
+            const Node& getNode(q3_int index) const { return QLL_Q3_ARRAY_ACCESS(_data.nodes, index); }
+            const Leaf& getLeaf(q3_int index) const { return QLL_Q3_ARRAY_ACCESS(_data.leaves, index); }
+            const Plane& getNodePlane(const Node& node) const { return QLL_Q3_ARRAY_ACCESS(_data.planes, node.plane); }
+
+            const Face& getLeafFace(const Leaf& leaf, q3_int i) const
+            {
+                return QLL_Q3_ARRAY_ACCESS(_data.faces, QLL_Q3_ARRAY_ACCESS(_data.leaf_faces, leaf.leafface + i));
+            }
+
+            const Brush& getLeafBrush(const Leaf& leaf, q3_int i) const
+            {
+                return QLL_Q3_ARRAY_ACCESS(_data.brushes, QLL_Q3_ARRAY_ACCESS(_data.leaf_brushes, leaf.leafbrush + i));
+            }
+
+            const Face& getModelFace(const Model& model, q3_int i) const { return QLL_Q3_ARRAY_ACCESS(_data.faces, model.face + i); }
+            const Brush& getModelBrush(const Model& model, q3_int i) const { return QLL_Q3_ARRAY_ACCESS(_data.brushes, model.brush + i); }
+
+            const Brushside& getBrushSide(const Brush& brush, q3_int i) const { return QLL_Q3_ARRAY_ACCESS(_data.brush_sides, brush.brushside + i); }
+            const Plane& getBrushSidePlane(const Brushside& side) const { return QLL_Q3_ARRAY_ACCESS(_data.planes, side.plane); }
+
+            const Texture& getFaceTexture(const Face& face) const { return QLL_Q3_ARRAY_ACCESS(_data.textures, face.texture); }
+            const Vertex& getFaceVertex(const Face& face, q3_int i) const { return QLL_Q3_ARRAY_ACCESS(_data.vertices, face.vertex + i); }
+
+            // Meshverts are offsets relative to the face first vertex
+            const Vertex& getFaceMeshVertex(const Face& face, q3_int i) const
+            {
+                return QLL_Q3_ARRAY_ACCESS(_data.vertices, face.vertex + QLL_Q3_ARRAY_ACCESS(_data.mesh_vertices, face.meshvert + i));
+            }
+
             /**
              * Check if the file is a valid bsp map
              */
             static bool isValid(const QLL_Q3_STRING& filename);
+            static bool isValid(Reader& reader);
         protected:
+            void _open(Reader& reader);
+            void _loadStage(q3_int stage);
+            void _decodeLump(q3_int lump, const q3_ubyte* raw, q3_int length);
+            void _validate();
+
             LevelData _data;
+            Reader* _reader;
+            q3_int _next_stage;
+            q3_int _checked_rules;     // Bitmask of the validation rules already run
+            q3_int _failed_rules;      // Bitmask of the validation rules which found a bad index
+            q3_int _failed_lumps;      // Bitmask of the lumps outside of the file or which could not be read
+            __lump_header _headers[__quake3_bsp_lumps_count];
     };
 }}
 
@@ -261,23 +460,25 @@ namespace qll { namespace q3 {
 
 #ifdef QLL_Q3_IMPLEMENTATION
 
-#ifndef QLL_Q3_FILE_TYPE
-    #include <string>
-    #define QLL_Q3_FILE_TYPE FILE*
-
-    #define QLL_Q3_FILE_FOPEN(STR) fopen(STR.c_str(), "r+b")
-    #define QLL_Q3_FILE_FCLOSE(HANDLE) fclose(HANDLE)
-
-    #define QLL_Q3_FILE_FREAD(TARGET, COUNT, SIZE, HANDLE) fread(TARGET, SIZE, COUNT, HANDLE)
-
-    #define QLL_Q3_FILE_FSEEK(HANDLE, OFFSET) fseek(HANDLE, OFFSET, SEEK_SET)
-#endif
+#include <cstring>
 
 #ifndef QLL_Q3_CUSTOM_MEMALLOC
     #define QLL_Q3_MALLOC(SIZE) malloc(SIZE)
     #define QLL_Q3_FREE(BUFFER) free(BUFFER)
 #endif
 
+#ifdef QLL_Q3_USE_PREADV
+    #include <climits>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+
+    #ifndef IOV_MAX
+        #define IOV_MAX 16
+    #endif
+#endif
+
 #define ENTITIES_LUMP         0x00
 #define TEXTURES_LUMP         0x01
 #define PLANES_LUMP           0x02
@@ -296,116 +497,307 @@ namespace qll { namespace q3 {
 #define LIGHTVOLS_LUMP        0x0F
 #define VISDATA_LUMP          0x10
 
+#define QLL_Q3_LUMP_BIT(LUMP) (1 << (LUMP))
+
 namespace qll { namespace q3 {
     #define QUAKE3_BSP_MAGIC_LEN 4
     static const q3_ubyte __quake3_bsp_magic[] = "IBSP";
     static const q3_int __quake3_bsp_version = 0x2e; // 46
 
-    static const q3_int __quake3_bsp_lumps_count = 17;
+    // Stage in which each lump is loaded (indexed by lump)
+    static const q3_int __quake3_lump_stages[__quake3_bsp_lumps_count] =
+    {
+        LOAD_STAGE_GAMEPLAY,       // Entities
+        LOAD_STAGE_GAMEPLAY,       // Textures
+        LOAD_STAGE_GAMEPLAY,       // Planes
+        LOAD_STAGE_GAMEPLAY,       // Nodes
+        LOAD_STAGE_GAMEPLAY,       // Leafs
+        LOAD_STAGE_GAMEPLAY,       // Leaffaces
+        LOAD_STAGE_GAMEPLAY,       // Leafbrushes
+        LOAD_STAGE_GAMEPLAY,       // Models
+        LOAD_STAGE_GAMEPLAY,       // Brushes
+        LOAD_STAGE_GAMEPLAY,       // Brushsides
+        LOAD_STAGE_GEOMETRY,       // Vertexes
+        LOAD_STAGE_GEOMETRY,       // Meshverts
+        LOAD_STAGE_GEOMETRY,       // Effects
+        LOAD_STAGE_GEOMETRY,       // Faces
+        LOAD_STAGE_LIGHTING,       // Lightmaps
+        LOAD_STAGE_LIGHTING,       // Lightvols
+        LOAD_STAGE_GEOMETRY        // Visdata
+    };
 
-    bool Q3Level::isValid(const QLL_Q3_STRING& filename)
+    // Readers
+
+    bool Reader::readMany(const ReadRequest* requests, q3_int count)
+    {
+        for (q3_int i = 0; i < count; ++i)
+        {
+            if (!read(requests[i].offset, requests[i].length, requests[i].target))
+                return false;
+        }
+
+        return true;
+    }
+
+    FileReader::FileReader(const QLL_Q3_STRING& filename)
+        : _handle(QLL_Q3_FILE_FOPEN(filename)), _size(-1), _position(-1),
+          _buffer(0), _buffer_offset(0), _buffer_length(0)
+    {
+        if (!_handle)
+            return;
+
+        _size = QLL_Q3_FILE_FSIZE(_handle);
+        _buffer = (q3_ubyte*)QLL_Q3_MALLOC(QLL_Q3_READ_AHEAD_SIZE);
+    }
+
+    FileReader::~FileReader()
     {
-        bool result = true;
+        if (_buffer)
+            QLL_Q3_FREE(_buffer);
+
+        if (_handle)
+            QLL_Q3_FILE_FCLOSE(_handle);
+    }
+
+    // Return the number of bytes read, or -1 if the seek failed
+    q3_int FileReader::_readDirect(q3_int offset, q3_int length, void* target)
+    {
+        if (_position != offset)
+        {
+            if (QLL_Q3_FILE_FSEEK(_handle, offset) != 0)
+            {
+                _position = -1;
+                return -1;
+            }
+
+            _position = offset;
+        }
+
+        q3_int read_length = QLL_Q3_FILE_FREAD(target, length, 1, _handle);
+        _position += read_length;
+
+        return read_length;
+    }
 
-        QLL_Q3_FILE_TYPE file_handle = QLL_Q3_FILE_FOPEN(filename);
+    bool FileReader::read(q3_int offset, q3_int length, void* target)
+    {
+        if (!_handle || offset < 0 || length < 0)
+            return false;
 
-        if (!file_handle)
+        // With an unknown size, reads past the end are caught by a short read
+        if (_size >= 0 && offset > _size - length)
             return false;
 
-        if (result)
+        q3_ubyte* output = (q3_ubyte*)target;
+
+        while (length > 0)
         {
-            // Check the magic number
-            q3_ubyte magic[QUAKE3_BSP_MAGIC_LEN];
-            QLL_Q3_FILE_FREAD(magic, 1, QUAKE3_BSP_MAGIC_LEN, file_handle);
+            if (offset >= _buffer_offset && offset < _buffer_offset + _buffer_length)
+            {
+                // Serve what we can from the read-ahead window
+                q3_int available = _buffer_offset + _buffer_length - offset;
+                q3_int chunk = length < available ? length : available;
+
+                memcpy(output, _buffer + (offset - _buffer_offset), chunk);
 
-            for (q3_ubyte i = 0; i< QUAKE3_BSP_MAGIC_LEN; ++i)
+                output += chunk;
+                offset += chunk;
+                length -= chunk;
+            }
+            else if (length >= QLL_Q3_READ_AHEAD_SIZE || !_buffer)
             {
-                if (magic[i] != __quake3_bsp_magic[i])
-                {
-                    result = false;
-                    break;
-                }
+                // Large reads go straight to the target buffer, as do all reads if the window could not be allocated
+                return _readDirect(offset, length, output) == length;
+            }
+            else
+            {
+                // Refill the window starting at the requested offset, it may end early at the end of the file
+                q3_int remaining = _size >= 0 ? _size - offset : QLL_Q3_READ_AHEAD_SIZE;
+                q3_int window = remaining < QLL_Q3_READ_AHEAD_SIZE ? remaining : QLL_Q3_READ_AHEAD_SIZE;
+
+                _buffer_offset = offset;
+                _buffer_length = 0;
+
+                q3_int read_length = _readDirect(offset, window, _buffer);
+
+                if (read_length <= 0)
+                    return false;
+
+                _buffer_length = read_length;
             }
         }
 
-        if (result)
+        return true;
+    }
+
+    #ifdef QLL_Q3_USE_PREADV
+    PosixReader::PosixReader(const QLL_Q3_STRING& filename)
+        : _fd(open(filename.c_str(), O_RDONLY)), _size(-1)
+    {
+        struct stat file_stat;
+
+        if (_fd >= 0 && fstat(_fd, &file_stat) == 0)
+            _size = (q3_int)file_stat.st_size;
+    }
+
+    PosixReader::~PosixReader()
+    {
+        if (_fd >= 0)
+            close(_fd);
+    }
+
+    bool PosixReader::read(q3_int offset, q3_int length, void* target)
+    {
+        if (_fd < 0 || offset < 0 || length < 0 || offset > _size - length)
+            return false;
+
+        q3_ubyte* output = (q3_ubyte*)target;
+
+        while (length > 0)
         {
-            // Check if the bsp version is the Quake3 one
-            q3_int version;
-            QLL_Q3_FILE_FREAD(&version, 1, sizeof(q3_int), file_handle);
+            ssize_t read_length = pread(_fd, output, length, offset);
+
+            if (read_length <= 0)
+                return false;
 
-            if (version != __quake3_bsp_version)
-                result = false;
+            output += read_length;
+            offset += read_length;
+            length -= read_length;
         }
 
-        if (file_handle)
-            QLL_Q3_FILE_FCLOSE(file_handle);
+        return true;
+    }
 
-        return result;
+    bool PosixReader::readMany(const ReadRequest* requests, q3_int count)
+    {
+        struct iovec vectors[IOV_MAX];
+
+        q3_int i = 0;
+
+        while (i < count)
+        {
+            // Gather requests which follow each other in the file
+            q3_int first = i;
+            q3_int run_length = 0;
+            int n_vectors = 0;
+
+            do
+            {
+                vectors[n_vectors].iov_base = requests[i].target;
+                vectors[n_vectors].iov_len = requests[i].length;
+                run_length += requests[i].length;
+
+                ++n_vectors;
+                ++i;
+            }
+            while (i < count && n_vectors < IOV_MAX && requests[i].offset == requests[i - 1].offset + requests[i - 1].length);
+
+            q3_int offset = requests[first].offset;
+
+            if (offset < 0 || run_length < 0 || offset > _size - run_length)
+                return false;
+
+            ssize_t read_length = preadv(_fd, vectors, n_vectors, offset);
+
+            if (read_length != run_length)
+            {
+                // Short scatter read, finish this run one request at a time
+                for (q3_int j = first; j < i; ++j)
+                {
+                    if (!read(requests[j].offset, requests[j].length, requests[j].target))
+                        return false;
+                }
+            }
+        }
+
+        return true;
     }
+    #endif
 
-    struct __lump_header
+    // Level
+
+    bool Q3Level::isValid(const QLL_Q3_STRING& filename)
     {
-        q3_int offset;
-        q3_int length;
-    };
+        FileReader reader(filename);
+
+        if (!reader.isOpen())
+            return false;
+
+        return isValid(reader);
+    }
+
+    bool Q3Level::isValid(Reader& reader)
+    {
+        q3_ubyte magic[QUAKE3_BSP_MAGIC_LEN];
+        q3_int version;
+
+        // Check the magic number
+        if (!reader.read(0, QUAKE3_BSP_MAGIC_LEN, magic))
+            return false;
+
+        for (q3_ubyte i = 0; i< QUAKE3_BSP_MAGIC_LEN; ++i)
+        {
+            if (magic[i] != __quake3_bsp_magic[i])
+                return false;
+        }
+
+        // Check if the bsp version is the Quake3 one
+        if (!reader.read(QUAKE3_BSP_MAGIC_LEN, sizeof(q3_int), &version))
+            return false;
+
+        return version == __quake3_bsp_version;
+    }
 
     template <typename T> static void __read_lump
     (
-        QLL_Q3_FILE_TYPE file_handle, QLL_Q3_ARRAY(T)& result, const __lump_header& header
+        const q3_ubyte* raw, q3_int length, QLL_Q3_ARRAY(T)& result
     );
 
     // Special case for texture lump
-    template <> void __read_lump(QLL_Q3_FILE_TYPE file_handle, QLL_Q3_ARRAY(Texture)& result, const __lump_header& header);
+    template <> void __read_lump(const q3_ubyte* raw, q3_int length, QLL_Q3_ARRAY(Texture)& result);
 
     // Special case for effect lump
-    template <> void __read_lump(QLL_Q3_FILE_TYPE file_handle, QLL_Q3_ARRAY(Effect)& result, const __lump_header& header);
+    template <> void __read_lump(const q3_ubyte* raw, q3_int length, QLL_Q3_ARRAY(Effect)& result);
 
     // Entities / Visdata have their own special cases
-    static void __read_entities_lump(QLL_Q3_FILE_TYPE file_handle, QLL_Q3_STRING& result, const __lump_header& header);
-    static void __read_visdata_lump(QLL_Q3_FILE_TYPE file_handle, Visdata& result, const __lump_header& header);
+    static void __read_entities_lump(const q3_ubyte* raw, q3_int length, QLL_Q3_STRING& result);
+    static bool __read_visdata_lump(const q3_ubyte* raw, q3_int length, Visdata& result);
 
-    static void __read_string(QLL_Q3_FILE_TYPE file_handle, QLL_Q3_STRING& result, const q3_int& length);
+    static void __read_string(const q3_ubyte* raw, q3_int length, QLL_Q3_STRING& result);
 
     Q3Level::Q3Level(const QLL_Q3_STRING& filename)
+        : _reader(0), _next_stage(LOAD_STAGE_GAMEPLAY), _checked_rules(0), _failed_rules(0), _failed_lumps(0)
     {
-        if (!isValid(filename))
+        _data.vis_data.n_vecs = 0;
+        _data.vis_data.sz_vecs = 0;
+        _data.vis_data.vecs = 0;
+
+        FileReader reader(filename);
+
+        if (!reader.isOpen() || !isValid(reader))
             return;
 
-        QLL_Q3_FILE_TYPE file_handle = QLL_Q3_FILE_FOPEN(filename);
+        _open(reader);
 
-        // Read headers (Ignore magic + version)
-        QLL_Q3_FILE_FSEEK(file_handle, QUAKE3_BSP_MAGIC_LEN + sizeof(q3_int));
+        while (loadNextStage());
+    }
+
+    Q3Level::Q3Level(Reader& reader, bool progressive)
+        : _reader(0), _next_stage(LOAD_STAGE_GAMEPLAY), _checked_rules(0), _failed_rules(0), _failed_lumps(0)
+    {
+        _data.vis_data.n_vecs = 0;
+        _data.vis_data.sz_vecs = 0;
+        _data.vis_data.vecs = 0;
 
-        QLL_Q3_ARRAY(__lump_header) headers;
+        if (!isValid(reader))
+            return;
 
-        for (q3_int i = 0; i<__quake3_bsp_lumps_count; ++i)
-        {
-            __lump_header item;
-            QLL_Q3_FILE_FREAD(&item, 1, sizeof(__lump_header), file_handle);
-            QLL_Q3_ARRAY_APPEND(headers, item);
-        }
+        _open(reader);
 
-        // Read all lumpes
-        __read_entities_lump(file_handle, _data.entities, headers[ENTITIES_LUMP]);
-        __read_lump<Texture>(file_handle, _data.textures, headers[TEXTURES_LUMP]);
-        __read_lump<Plane>(file_handle, _data.planes, headers[PLANES_LUMP]);
-        __read_lump<Node>(file_handle, _data.nodes, headers[NODES_LUMP]);
-        __read_lump<Leaf>(file_handle, _data.leaves, headers[LEAF_LUMP]);
-        __read_lump<Leafface>(file_handle, _data.leaf_faces, headers[LEAFFACES_LUMP]);
-        __read_lump<Leafbrush>(file_handle, _data.leaf_brushes, headers[LEAFBRUSHES_LUMP]);
-        __read_lump<Model>(file_handle, _data.models, headers[MODELS_LUMP]);
-        __read_lump<Brush>(file_handle, _data.brushes, headers[BRUSHES_LUMP]);
-        __read_lump<Brushside>(file_handle, _data.brush_sides, headers[BRUSHSIDES_LUMP]);
-        __read_lump<Vertex>(file_handle, _data.vertices, headers[VERTICES_LUMP]);
-        __read_lump<Meshvert>(file_handle, _data.mesh_vertices, headers[MESHVERTS_LUMP]);
-        __read_lump<Effect>(file_handle, _data.effects, headers[EFFECTS_LUMP]);
-        __read_lump<Face>(file_handle, _data.faces, headers[FACES_LUMP]);
-        __read_lump<Lightmap>(file_handle, _data.light_maps, headers[LIGHTMAPS_LUMP]);
-        __read_lump<Lightvol>(file_handle, _data.light_vols, headers[LIGHTVOLS_LUMP]);
-        __read_visdata_lump(file_handle, _data.vis_data, headers[VISDATA_LUMP]);
-
-        QLL_Q3_FILE_FCLOSE(file_handle);
+        if (progressive)
+            loadNextStage();
+        else
+            while (loadNextStage());
     }
 
     Q3Level::~Q3Level()
@@ -414,61 +806,457 @@ namespace qll { namespace q3 {
             QLL_Q3_FREE(_data.vis_data.vecs);
     }
 
+    void Q3Level::_open(Reader& reader)
+    {
+        // Read headers (Ignore magic + version)
+        if (!reader.read(QUAKE3_BSP_MAGIC_LEN + sizeof(q3_int), sizeof(_headers), _headers))
+            return;
+
+        // Lumps pointing outside of the file are left empty
+        q3_int file_size = reader.size();
+
+        for (q3_int i = 0; i < __quake3_bsp_lumps_count; ++i)
+        {
+            __lump_header& header = _headers[i];
+
+            if (header.offset < 0 || header.length < 0 || (file_size >= 0 && header.offset > file_size - header.length))
+            {
+                header.offset = header.length = 0;
+                _failed_lumps |= QLL_Q3_LUMP_BIT(i);
+            }
+        }
+
+        _reader = &reader;
+        _next_stage = LOAD_STAGE_GAMEPLAY;
+    }
+
+    bool Q3Level::loadNextStage()
+    {
+        if (!_reader || _next_stage >= LOAD_STAGE_COUNT)
+            return false;
+
+        _loadStage(_next_stage++);
+        _validate();
+
+        if (_next_stage >= LOAD_STAGE_COUNT)
+            _reader = 0;
+
+        return _next_stage < LOAD_STAGE_COUNT;
+    }
+
+    void Q3Level::_loadStage(q3_int stage)
+    {
+        ReadRequest requests[__quake3_bsp_lumps_count];
+        q3_int lumps[__quake3_bsp_lumps_count];
+        q3_int count = 0;
+        q3_int stage_lumps = 0;
+        size_t total_length = 0;
+
+        // Sort the lumps of this stage by offset (insertion sort, there are at most 17 of them)
+        for (q3_int i = 0; i < __quake3_bsp_lumps_count; ++i)
+        {
+            if (__quake3_lump_stages[i] != stage || _headers[i].length == 0)
+                continue;
+
+            stage_lumps |= QLL_Q3_LUMP_BIT(i);
+
+            q3_int j = count++;
+
+            while (j > 0 && _headers[lumps[j - 1]].offset > _headers[i].offset)
+            {
+                lumps[j] = lumps[j - 1];
+                --j;
+            }
+
+            lumps[j] = i;
+            total_length += (size_t)_headers[i].length;
+        }
+
+        if (count == 0)
+            return;
+
+        // Lumps are only bounds checked one by one, overlapping lumps could add up to more than the file
+        q3_int file_size = _reader->size();
+        size_t max_length = file_size >= 0 ? (size_t)file_size : (size_t)0x7fffffff;
+
+        if (total_length > max_length)
+        {
+            _failed_lumps |= stage_lumps;
+            return;
+        }
+
+        // A single buffer holds the whole stage, lumps are decoded from it once everything is read
+        q3_ubyte* raw = (q3_ubyte*)QLL_Q3_MALLOC(total_length);
+        size_t position = 0;
+
+        if (!raw)
+        {
+            _failed_lumps |= stage_lumps;
+            return;
+        }
+
+        for (q3_int i = 0; i < count; ++i)
+        {
+            requests[i].offset = _headers[lumps[i]].offset;
+            requests[i].length = _headers[lumps[i]].length;
+            requests[i].target = raw + position;
+
+            position += requests[i].length;
+        }
+
+        if (_reader->readMany(requests, count))
+        {
+            for (q3_int i = 0; i < count; ++i)
+                _decodeLump(lumps[i], (const q3_ubyte*)requests[i].target, requests[i].length);
+        }
+        else
+            _failed_lumps |= stage_lumps;
+
+        QLL_Q3_FREE(raw);
+    }
+
+    void Q3Level::_decodeLump(q3_int lump, const q3_ubyte* raw, q3_int length)
+    {
+        switch (lump)
+        {
+            case ENTITIES_LUMP: __read_entities_lump(raw, length, _data.entities); break;
+            case TEXTURES_LUMP: __read_lump<Texture>(raw, length, _data.textures); break;
+            case PLANES_LUMP: __read_lump<Plane>(raw, length, _data.planes); break;
+            case NODES_LUMP: __read_lump<Node>(raw, length, _data.nodes); break;
+            case LEAF_LUMP: __read_lump<Leaf>(raw, length, _data.leaves); break;
+            case LEAFFACES_LUMP: __read_lump<Leafface>(raw, length, _data.leaf_faces); break;
+            case LEAFBRUSHES_LUMP: __read_lump<Leafbrush>(raw, length, _data.leaf_brushes); break;
+            case MODELS_LUMP: __read_lump<Model>(raw, length, _data.models); break;
+            case BRUSHES_LUMP: __read_lump<Brush>(raw, length, _data.brushes); break;
+            case BRUSHSIDES_LUMP: __read_lump<Brushside>(raw, length, _data.brush_sides); break;
+            case VERTICES_LUMP: __read_lump<Vertex>(raw, length, _data.vertices); break;
+            case MESHVERTS_LUMP: __read_lump<Meshvert>(raw, length, _data.mesh_vertices); break;
+            case EFFECTS_LUMP: __read_lump<Effect>(raw, length, _data.effects); break;
+            case FACES_LUMP: __read_lump<Face>(raw, length, _data.faces); break;
+            case LIGHTMAPS_LUMP: __read_lump<Lightmap>(raw, length, _data.light_maps); break;
+            case LIGHTVOLS_LUMP: __read_lump<Lightvol>(raw, length, _data.light_vols); break;
+            case VISDATA_LUMP:
+                if (!__read_visdata_lump(raw, length, _data.vis_data))
+                    _failed_lumps |= QLL_Q3_LUMP_BIT(VISDATA_LUMP);
+                break;
+        }
+    }
+
+    // Validation
+
+    typedef unsigned int q3_uint;
+
+    // The checks below are branchless reductions over the whole lump, so compilers can vectorize them
+
+    // Check that the field of every item is in [lower, upper)
+    template <typename T> static bool __check_index
+    (
+        const QLL_Q3_ARRAY(T)& items, q3_int T::*field, q3_int lower, q3_int upper
+    )
+    {
+        q3_uint failed = 0;
+        q3_uint span = (q3_uint)upper - (q3_uint)lower;
+        q3_int count = QLL_Q3_ARRAY_SIZE(items);
+
+        for (q3_int i = 0; i < count; ++i)
+            failed |= (q3_uint)(QLL_Q3_ARRAY_ACCESS(items, i).*field) - (q3_uint)lower >= span;
+
+        return !failed;
+    }
+
+    // Same as above for lumps made of plain indices (leaffaces, leafbrushes, meshverts)
+    static bool __check_index
+    (
+        const QLL_Q3_ARRAY(q3_int)& items, q3_int first, q3_int count, q3_int lower, q3_int upper
+    )
+    {
+        q3_uint failed = 0;
+        q3_uint span = (q3_uint)upper - (q3_uint)lower;
+
+        for (q3_int i = first; i < first + count; ++i)
+            failed |= (q3_uint)QLL_Q3_ARRAY_ACCESS(items, i) - (q3_uint)lower >= span;
+
+        return !failed;
+    }
+
+    // Check that [first, first + count) of every item fits in [0, total)
+    // Both fields are copied by blocks first, compilers do not vectorize two strided loads from the same item
+    template <typename T> static bool __check_range
+    (
+        const QLL_Q3_ARRAY(T)& items, q3_int T::*first, q3_int T::*count, q3_int total
+    )
+    {
+        const q3_int block_size = 256;
+        q3_uint firsts[block_size];
+        q3_uint counts[block_size];
+
+        q3_uint failed = 0;
+        q3_int n_items = QLL_Q3_ARRAY_SIZE(items);
+
+        for (q3_int start = 0; start < n_items; start += block_size)
+        {
+            q3_int size = n_items - start < block_size ? n_items - start : block_size;
+
+            for (q3_int i = 0; i < size; ++i)
+                firsts[i] = (q3_uint)(QLL_Q3_ARRAY_ACCESS(items, start + i).*first);
+
+            for (q3_int i = 0; i < size; ++i)
+                counts[i] = (q3_uint)(QLL_Q3_ARRAY_ACCESS(items, start + i).*count);
+
+            // Negative values wrap to huge unsigned ones
+            for (q3_int i = 0; i < size; ++i)
+                failed |= (q3_uint)(firsts[i] > (q3_uint)total) | (q3_uint)(counts[i] > (q3_uint)total - firsts[i]);
+        }
+
+        return !failed;
+    }
+
+    static bool __check_nodes(const LevelData& data)
+    {
+        q3_int n_nodes = QLL_Q3_ARRAY_SIZE(data.nodes);
+        q3_int n_leaves = QLL_Q3_ARRAY_SIZE(data.leaves);
+
+        // Negative children are leaves, stored as -(leaf + 1)
+        return __check_index<Node>(data.nodes, &Node::plane, 0, QLL_Q3_ARRAY_SIZE(data.planes))
+            && __check_index<Node>(data.nodes, &Node::front, -n_leaves, n_nodes)
+            && __check_index<Node>(data.nodes, &Node::back, -n_leaves, n_nodes);
+    }
+
+    static bool __check_leaves(const LevelData& data)
+    {
+        return __check_range<Leaf>(data.leaves, &Leaf::leafface, &Leaf::n_leaffaces, QLL_Q3_ARRAY_SIZE(data.leaf_faces))
+            && __check_range<Leaf>(data.leaves, &Leaf::leafbrush, &Leaf::n_leafbrushes, QLL_Q3_ARRAY_SIZE(data.leaf_brushes));
+    }
+
+    static bool __check_leaf_clusters(const LevelData& data)
+    {
+        const Visdata& vis_data = data.vis_data;
+
+        // Without visdata everything is visible, clusters are not used
+        if (!vis_data.vecs)
+            return true;
+
+        // Each vector needs one bit per cluster
+        return (vis_data.n_vecs + 7) / 8 <= vis_data.sz_vecs
+            && __check_index<Leaf>(data.leaves, &Leaf::cluster, -1, vis_data.n_vecs);
+    }
+
+    static bool __check_leaf_faces(const LevelData& data)
+    {
+        return __check_index(data.leaf_faces, 0, QLL_Q3_ARRAY_SIZE(data.leaf_faces), 0, QLL_Q3_ARRAY_SIZE(data.faces));
+    }
+
+    static bool __check_leaf_brushes(const LevelData& data)
+    {
+        return __check_index(data.leaf_brushes, 0, QLL_Q3_ARRAY_SIZE(data.leaf_brushes), 0, QLL_Q3_ARRAY_SIZE(data.brushes));
+    }
+
+    static bool __check_models(const LevelData& data)
+    {
+        return __check_range<Model>(data.models, &Model::brush, &Model::n_brushes, QLL_Q3_ARRAY_SIZE(data.brushes));
+    }
+
+    static bool __check_model_faces(const LevelData& data)
+    {
+        return __check_range<Model>(data.models, &Model::face, &Model::n_faces, QLL_Q3_ARRAY_SIZE(data.faces));
+    }
+
+    static bool __check_brushes(const LevelData& data)
+    {
+        return __check_range<Brush>(data.brushes, &Brush::brushside, &Brush::n_brushsides, QLL_Q3_ARRAY_SIZE(data.brush_sides))
+            && __check_index<Brush>(data.brushes, &Brush::texture, 0, QLL_Q3_ARRAY_SIZE(data.textures));
+    }
+
+    static bool __check_brush_sides(const LevelData& data)
+    {
+        return __check_index<Brushside>(data.brush_sides, &Brushside::plane, 0, QLL_Q3_ARRAY_SIZE(data.planes))
+            && __check_index<Brushside>(data.brush_sides, &Brushside::texture, 0, QLL_Q3_ARRAY_SIZE(data.textures));
+    }
+
+    static bool __check_effects(const LevelData& data)
+    {
+        return __check_index<Effect>(data.effects, &Effect::brush, -1, QLL_Q3_ARRAY_SIZE(data.brushes));
+    }
+
+    static bool __check_faces(const LevelData& data)
+    {
+        if (!__check_index<Face>(data.faces, &Face::texture, 0, QLL_Q3_ARRAY_SIZE(data.textures))
+            || !__check_index<Face>(data.faces, &Face::effect, -1, QLL_Q3_ARRAY_SIZE(data.effects))
+            || !__check_range<Face>(data.faces, &Face::vertex, &Face::n_vertices, QLL_Q3_ARRAY_SIZE(data.vertices))
+            || !__check_range<Face>(data.faces, &Face::meshvert, &Face::n_meshverts, QLL_Q3_ARRAY_SIZE(data.mesh_vertices)))
+            return false;
+
+        // Patch control points (patch_size[0] * patch_size[1]) are not checked against n_vertices,
+        // patch tessellation code must clamp them itself
+
+        // Meshverts are relative to the face first vertex, the ranges above make this loop safe.
+        // Each face runs the vectorized index check, results are accumulated without early exit
+        q3_uint failed = 0;
+        q3_int n_faces = QLL_Q3_ARRAY_SIZE(data.faces);
+
+        for (q3_int i = 0; i < n_faces; ++i)
+        {
+            const Face& face = QLL_Q3_ARRAY_ACCESS(data.faces, i);
+
+            failed |= !__check_index(data.mesh_vertices, face.meshvert, face.n_meshverts, 0, face.n_vertices);
+        }
+
+        return !failed;
+    }
+
+    static bool __check_face_lightmaps(const LevelData& data)
+    {
+        q3_uint failed = 0;
+        q3_int n_faces = QLL_Q3_ARRAY_SIZE(data.faces);
+        q3_int n_lightmaps = QLL_Q3_ARRAY_SIZE(data.light_maps);
+
+        // Maps built with external lightmaps (q3map2 -external) have an empty lump, indices refer to image files
+        if (n_lightmaps == 0)
+            return true;
+
+        // Negative indices are special values (no lightmap, vertex lighting...)
+        for (q3_int i = 0; i < n_faces; ++i)
+            failed |= QLL_Q3_ARRAY_ACCESS(data.faces, i).lm_index >= n_lightmaps;
+
+        return !failed;
+    }
+
+    struct __validation_rule
+    {
+        q3_int lumps;              // Lumps which must be loaded before running the check
+        bool (*check)(const LevelData& data);
+    };
+
+    static const __validation_rule __validation_rules[] =
+    {
+        { QLL_Q3_LUMP_BIT(NODES_LUMP) | QLL_Q3_LUMP_BIT(PLANES_LUMP) | QLL_Q3_LUMP_BIT(LEAF_LUMP), __check_nodes },
+        { QLL_Q3_LUMP_BIT(LEAF_LUMP) | QLL_Q3_LUMP_BIT(LEAFFACES_LUMP) | QLL_Q3_LUMP_BIT(LEAFBRUSHES_LUMP), __check_leaves },
+        { QLL_Q3_LUMP_BIT(LEAF_LUMP) | QLL_Q3_LUMP_BIT(VISDATA_LUMP), __check_leaf_clusters },
+        { QLL_Q3_LUMP_BIT(LEAFFACES_LUMP) | QLL_Q3_LUMP_BIT(FACES_LUMP), __check_leaf_faces },
+        { QLL_Q3_LUMP_BIT(LEAFBRUSHES_LUMP) | QLL_Q3_LUMP_BIT(BRUSHES_LUMP), __check_leaf_brushes },
+        { QLL_Q3_LUMP_BIT(MODELS_LUMP) | QLL_Q3_LUMP_BIT(BRUSHES_LUMP), __check_models },
+        { QLL_Q3_LUMP_BIT(MODELS_LUMP) | QLL_Q3_LUMP_BIT(FACES_LUMP), __check_model_faces },
+        { QLL_Q3_LUMP_BIT(BRUSHES_LUMP) | QLL_Q3_LUMP_BIT(BRUSHSIDES_LUMP) | QLL_Q3_LUMP_BIT(TEXTURES_LUMP), __check_brushes },
+        { QLL_Q3_LUMP_BIT(BRUSHSIDES_LUMP) | QLL_Q3_LUMP_BIT(PLANES_LUMP) | QLL_Q3_LUMP_BIT(TEXTURES_LUMP), __check_brush_sides },
+        { QLL_Q3_LUMP_BIT(EFFECTS_LUMP) | QLL_Q3_LUMP_BIT(BRUSHES_LUMP), __check_effects },
+        {
+            QLL_Q3_LUMP_BIT(FACES_LUMP) | QLL_Q3_LUMP_BIT(TEXTURES_LUMP) | QLL_Q3_LUMP_BIT(EFFECTS_LUMP)
+            | QLL_Q3_LUMP_BIT(VERTICES_LUMP) | QLL_Q3_LUMP_BIT(MESHVERTS_LUMP),
+            __check_faces
+        },
+        { QLL_Q3_LUMP_BIT(FACES_LUMP) | QLL_Q3_LUMP_BIT(LIGHTMAPS_LUMP), __check_face_lightmaps }
+    };
+
+    static const q3_int __validation_rules_count = sizeof(__validation_rules) / sizeof(__validation_rule);
+
+    void Q3Level::_validate()
+    {
+        q3_int loaded_lumps = 0;
+
+        for (q3_int i = 0; i < __quake3_bsp_lumps_count; ++i)
+        {
+            if (__quake3_lump_stages[i] < _next_stage)
+                loaded_lumps |= QLL_Q3_LUMP_BIT(i);
+        }
+
+        // Run each rule once, as soon as all the lumps it references are available
+        for (q3_int i = 0; i < __validation_rules_count; ++i)
+        {
+            const __validation_rule& rule = __validation_rules[i];
+
+            if ((_checked_rules & (1 << i)) || (rule.lumps & loaded_lumps) != rule.lumps)
+                continue;
+
+            if (!rule.check(_data))
+                _failed_rules |= 1 << i;
+
+            _checked_rules |= 1 << i;
+        }
+    }
+
+    bool Q3Level::isValidated(q3_int stage) const
+    {
+        if (stage < 0 || stage >= _next_stage || stage >= LOAD_STAGE_COUNT)
+            return false;
+
+        q3_int stage_lumps = 0;
+
+        for (q3_int i = 0; i < __quake3_bsp_lumps_count; ++i)
+        {
+            if (__quake3_lump_stages[i] <= stage)
+                stage_lumps |= QLL_Q3_LUMP_BIT(i);
+        }
+
+        if (_failed_lumps & stage_lumps)
+            return false;
+
+        // Every rule limited to those stages must have run without finding a bad index
+        for (q3_int i = 0; i < __validation_rules_count; ++i)
+        {
+            if ((__validation_rules[i].lumps & stage_lumps) != __validation_rules[i].lumps)
+                continue;
+
+            if (!(_checked_rules & (1 << i)) || (_failed_rules & (1 << i)))
+                return false;
+        }
+
+        return true;
+    }
+
     // Tools functions
 
-    static void __read_string(
-        QLL_Q3_FILE_TYPE file_handle,
-        QLL_Q3_STRING& result,
-        const q3_int& length
+    static void __read_string
+    (
+        const q3_ubyte* raw,
+        q3_int length,
+        QLL_Q3_STRING& result
     )
     {
-        char* raw_data = (char*)QLL_Q3_MALLOC(length);
+        // Names are not always null terminated
+        char* raw_data = (char*)QLL_Q3_MALLOC(length + 1);
+
+        memcpy(raw_data, raw, length);
+        raw_data[length] = '\0';
 
-        QLL_Q3_FILE_FREAD(raw_data, 1, length, file_handle);
         result = QLL_Q3_STRING(raw_data);
         QLL_Q3_FREE(raw_data);
     }
 
     template <typename T> static void __read_lump
     (
-        QLL_Q3_FILE_TYPE file_handle,
-        QLL_Q3_ARRAY(T)& result,
-        const __lump_header& header
+        const q3_ubyte* raw,
+        q3_int length,
+        QLL_Q3_ARRAY(T)& result
     )
     {
-        int item_count = header.length / sizeof(T);
-
-        // Go to the start of the chunk.
-        QLL_Q3_FILE_FSEEK(file_handle, header.offset);
+        int item_count = length / sizeof(T);
 
         for (int i = 0; i < item_count; ++i)
         {
             T item;
-            QLL_Q3_FILE_FREAD(&item, 1, sizeof(T), file_handle);
+            memcpy(&item, raw + i * sizeof(T), sizeof(T));
             QLL_Q3_ARRAY_APPEND(result, item);
         }
     }
 
     template <> void __read_lump
     (
-        QLL_Q3_FILE_TYPE file_handle,
-        QLL_Q3_ARRAY(Texture)& result,
-        const __lump_header& header
+        const q3_ubyte* raw,
+        q3_int length,
+        QLL_Q3_ARRAY(Texture)& result
     )
     {
         const int lump_size = 2 * sizeof(q3_int) + 64;
-        int item_count = header.length / lump_size;
-
-        // Go to the start of the chunk.
-        QLL_Q3_FILE_FSEEK(file_handle, header.offset);
+        int item_count = length / lump_size;
 
         for (int i = 0; i < item_count; ++i)
         {
+            const q3_ubyte* item_raw = raw + i * lump_size;
             Texture item;
 
-            __read_string(file_handle, item.name, 64);
-            QLL_Q3_FILE_FREAD(&item.flags, 1, sizeof(q3_int), file_handle);
-            QLL_Q3_FILE_FREAD(&item.contents, 1, sizeof(q3_int), file_handle);
+            __read_string(item_raw, 64, item.name);
+            memcpy(&item.flags, item_raw + 64, sizeof(q3_int));
+            memcpy(&item.contents, item_raw + 64 + sizeof(q3_int), sizeof(q3_int));
 
             QLL_Q3_ARRAY_APPEND(result, item);
         }
@@ -476,64 +1264,70 @@ namespace qll { namespace q3 {
 
     template <> void __read_lump
     (
-        QLL_Q3_FILE_TYPE file_handle,
-        QLL_Q3_ARRAY(Effect)& result,
-        const __lump_header& header
+        const q3_ubyte* raw,
+        q3_int length,
+        QLL_Q3_ARRAY(Effect)& result
     )
     {
         const int lump_size = 2 * sizeof(q3_int) + 64;
-        int item_count = header.length / lump_size;
-
-        // Go to the start of the chunk.
-        QLL_Q3_FILE_FSEEK(file_handle, header.offset);
+        int item_count = length / lump_size;
 
         for (int i = 0; i < item_count; ++i)
         {
+            const q3_ubyte* item_raw = raw + i * lump_size;
             Effect item;
 
-            __read_string(file_handle, item.name, 64);
-            QLL_Q3_FILE_FREAD(&item.brush, 1, sizeof(q3_int), file_handle);
-            QLL_Q3_FILE_FREAD(&item.unknown, 1, sizeof(q3_int), file_handle);
+            __read_string(item_raw, 64, item.name);
+            memcpy(&item.brush, item_raw + 64, sizeof(q3_int));
+            memcpy(&item.unknown, item_raw + 64 + sizeof(q3_int), sizeof(q3_int));
 
             QLL_Q3_ARRAY_APPEND(result, item);
         }
     }
 
-    static void __read_visdata_lump
+    static bool __read_visdata_lump
     (
-        QLL_Q3_FILE_TYPE file_handle,
-        Visdata& result,
-        const __lump_header& header
+        const q3_ubyte* raw,
+        q3_int length,
+        Visdata& result
     )
     {
-        QLL_Q3_FILE_FSEEK(file_handle, header.offset);
+        if (length < 2 * (q3_int)sizeof(q3_int))
+            return false;
+
+        memcpy(&result.n_vecs, raw, sizeof(q3_int));
+        memcpy(&result.sz_vecs, raw + sizeof(q3_int), sizeof(q3_int));
+
+        q3_int available = length - 2 * (q3_int)sizeof(q3_int);
 
-        QLL_Q3_FILE_FREAD(&result.n_vecs, 1, sizeof(q3_int), file_handle);
-        QLL_Q3_FILE_FREAD(&result.sz_vecs, 1, sizeof(q3_int), file_handle);
+        // Do not trust the vector count beyond what the lump holds
+        if (result.n_vecs < 0 || result.sz_vecs < 0 || result.sz_vecs > available
+            || (result.sz_vecs > 0 && result.n_vecs > available / result.sz_vecs))
+        {
+            result.n_vecs = result.sz_vecs = 0;
+            return false;
+        }
 
         int visdata_length = result.n_vecs * result.sz_vecs;
 
         result.vecs = (q3_ubyte*)QLL_Q3_MALLOC(visdata_length);
 
-        QLL_Q3_FILE_FREAD(result.vecs, 1, visdata_length, file_handle);
+        if (!result.vecs)
+            return visdata_length == 0;
+
+        memcpy(result.vecs, raw + 2 * sizeof(q3_int), visdata_length);
+
+        return true;
     }
 
     static void __read_entities_lump
     (
-        QLL_Q3_FILE_TYPE file_handle,
-        QLL_Q3_STRING& result,
-        const __lump_header& header
+        const q3_ubyte* raw,
+        q3_int length,
+        QLL_Q3_STRING& result
     )
     {
-        QLL_Q3_FILE_FSEEK(file_handle, header.offset);
-
-        char* entity_raw = (char*)QLL_Q3_MALLOC(header.length);
-
-        QLL_Q3_FILE_FREAD(entity_raw, header.length, 1, file_handle);
-
-        result = QLL_Q3_STRING(entity_raw);
-
-        QLL_Q3_FREE(entity_raw);
+        __read_string(raw, length, result);
     }
 
 
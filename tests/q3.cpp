@@ -1,8 +1,82 @@
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define QLL_Q3_USE_PREADV
+#endif
 
 #define QLL_Q3_IMPLEMENTATION
 #include "../qll_q3.h"
 
+// Reader over a file copy in memory, used to load corrupted maps
+class MemoryReader : public qll::q3::Reader
+{
+    public:
+        MemoryReader(const std::vector<unsigned char>& bytes) : _bytes(bytes) {}
+
+        qll::q3::q3_int size() { return _bytes.size(); }
+
+        bool read(qll::q3::q3_int offset, qll::q3::q3_int length, void* target)
+        {
+            if (offset < 0 || length < 0 || offset > size() - length)
+                return false;
+
+            memcpy(target, _bytes.data() + offset, length);
+            return true;
+        }
+    protected:
+        std::vector<unsigned char> _bytes;
+};
+
+static qll::q3::q3_int read_int(const std::vector<unsigned char>& bytes, size_t position)
+{
+    qll::q3::q3_int value;
+    memcpy(&value, bytes.data() + position, sizeof(value));
+    return value;
+}
+
+static void write_int(std::vector<unsigned char>& bytes, size_t position, qll::q3::q3_int value)
+{
+    memcpy(bytes.data() + position, &value, sizeof(value));
+}
+
+// Position of a lump header field in the file (after magic + version)
+static size_t lump_header(int lump) { return 8 + lump * 8; }
+
+static bool is_rejected(const char* name, const std::vector<unsigned char>& bytes)
+{
+    MemoryReader reader(bytes);
+    qll::q3::Q3Level corrupted_level(reader);
+
+    std::cout << "Corrupted map (" << name << ") is " << (corrupted_level.isValidated() ? "valid" : "malformed") << std::endl;
+
+    return !corrupted_level.isValidated();
+}
+
+static bool same_lump_counts(const qll::q3::LevelData& a, const qll::q3::LevelData& b)
+{
+    return a.entities == b.entities
+        && a.textures.size() == b.textures.size()
+        && a.planes.size() == b.planes.size()
+        && a.nodes.size() == b.nodes.size()
+        && a.leaves.size() == b.leaves.size()
+        && a.leaf_faces.size() == b.leaf_faces.size()
+        && a.leaf_brushes.size() == b.leaf_brushes.size()
+        && a.models.size() == b.models.size()
+        && a.brushes.size() == b.brushes.size()
+        && a.brush_sides.size() == b.brush_sides.size()
+        && a.vertices.size() == b.vertices.size()
+        && a.mesh_vertices.size() == b.mesh_vertices.size()
+        && a.effects.size() == b.effects.size()
+        && a.faces.size() == b.faces.size()
+        && a.light_maps.size() == b.light_maps.size()
+        && a.light_vols.size() == b.light_vols.size()
+        && a.vis_data.n_vecs == b.vis_data.n_vecs
+        && a.vis_data.sz_vecs == b.vis_data.sz_vecs;
+}
+
 int main(int argc, char** argv)
 {
     unsigned int count;
@@ -52,5 +126,118 @@ int main(int argc, char** argv)
     std::cout << "There are " << level_data.faces.size() << " faces" << std::endl;
     std::cout << "There are " << level_data.brushes.size() << " brushes" << std::endl;
 
+    // Every lump bound and index reference is checked while loading, unchecked accessors can be used afterwards
+    std::cout << "Level is " << (level.isValidated() ? "valid" : "malformed") << std::endl;
+
+    if (level.isValidated())
+    {
+        unsigned int vertex_count = 0;
+
+        for (unsigned int i = 0; i < level_data.leaves.size(); ++i)
+        {
+            const qll::q3::Leaf& leaf = level.getLeaf(i);
+
+            for (int j = 0; j < leaf.n_leaffaces; ++j)
+                vertex_count += level.getLeafFace(leaf, j).n_vertices;
+        }
+
+        std::cout << "Leaves reference " << vertex_count << " vertices" << std::endl;
+    }
+
+    std::cout << std::endl;
+
+    // Progressive loading: gameplay lumps are available first, the rest is streamed stage by stage
+    qll::q3::FileReader reader("data/test.bsp");
+    qll::q3::Q3Level streamed_level(reader, true);
+
+    while (true)
+    {
+        const qll::q3::LevelData& streamed_data = streamed_level.getData();
+
+        std::cout << "Stage " << streamed_level.getLoadedStages() << "/" << qll::q3::LOAD_STAGE_COUNT << ": "
+                  << streamed_data.brushes.size() << " brushes, "
+                  << streamed_data.faces.size() << " faces, "
+                  << streamed_data.light_maps.size() << " lightmaps" << std::endl;
+
+        if (!streamed_level.isLoading())
+            break;
+
+        streamed_level.loadNextStage();
+    }
+
+    if (streamed_level.getLoadedStages() != qll::q3::LOAD_STAGE_COUNT)
+    {
+        std::cout << "Progressive load did not complete" << std::endl;
+        return 1;
+    }
+
+    // A map which cannot be opened has no stage loaded
+    qll::q3::FileReader missing_reader("data/nonexistent.bsp");
+    qll::q3::Q3Level missing_level(missing_reader, true);
+
+    if (missing_level.isLoading() || missing_level.getLoadedStages() != 0)
+    {
+        std::cout << "Missing map reported as loaded" << std::endl;
+        return 1;
+    }
+
+    if (!same_lump_counts(level_data, streamed_level.getData()))
+    {
+        std::cout << "Progressive load differs from the full load" << std::endl;
+        return 1;
+    }
+
+    // A progressive load is only fully validated once every stage is loaded
+    qll::q3::FileReader partial_reader("data/test.bsp");
+    qll::q3::Q3Level partial_level(partial_reader, true);
+
+    if (partial_level.isValidated() || !partial_level.isValidated(qll::q3::LOAD_STAGE_GAMEPLAY))
+    {
+        std::cout << "Gameplay stage validation is wrong" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::endl;
+
+    // Malformed maps must be rejected without crashing
+    std::ifstream file("data/test.bsp", std::ios::binary);
+    const std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    std::vector<unsigned char> bad_leafface = bytes;
+    write_int(bad_leafface, read_int(bytes, lump_header(5)), 100000);
+
+    // The first faces of test.bsp use meshverts from index 6
+    std::vector<unsigned char> bad_meshvert = bytes;
+    write_int(bad_meshvert, read_int(bytes, lump_header(11)) + 6 * 4, 100);
+
+    std::vector<unsigned char> negative_offset = bytes;
+    write_int(negative_offset, lump_header(2), -16);
+
+    // Every gameplay lump covers the whole file
+    std::vector<unsigned char> overlapping_lumps = bytes;
+
+    for (int lump = 0; lump < 10; ++lump)
+    {
+        write_int(overlapping_lumps, lump_header(lump), 0);
+        write_int(overlapping_lumps, lump_header(lump) + 4, bytes.size());
+    }
+
+    if (!is_rejected("leafface out of range", bad_leafface)
+        || !is_rejected("meshvert out of range", bad_meshvert)
+        || !is_rejected("negative lump offset", negative_offset)
+        || !is_rejected("overlapping lumps", overlapping_lumps))
+        return 1;
+
+#ifdef QLL_Q3_USE_PREADV
+    // Adjacent lumps are fetched with a single preadv call
+    qll::q3::PosixReader posix_reader("data/test.bsp");
+    qll::q3::Q3Level posix_level(posix_reader);
+
+    std::cout << "PosixReader load " << (same_lump_counts(level_data, posix_level.getData()) ? "matches" : "differs from") << " FileReader load" << std::endl;
+
+    if (!same_lump_counts(level_data, posix_level.getData()))
+        return 1;
+#endif
+
     return 0;
 }
\ No newline at end of file